@@ -0,0 +1,217 @@
+/*
+ * =====================================================================================
+ * Copyright (C) 2018 M.S.Khan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * =====================================================================================
+ */
+
+/*
+ * fuzzy_bench.cpp
+ *
+ *     version  : 1.1.0
+ *  created on  : 18 Oct 2026
+ *      author  : agent
+ *
+ *  Checks that batched evaluation gives the same outputs as the fuzzy engine
+ *  and reports the throughput of both on one thread. Build from this directory :
+ *
+ *      g++ -std=c++11 -O3 -march=native -I../fuzzy ../fuzzy/fuzzy_controller.cpp \
+ *          ../fuzzy/fuzzy_rules.cpp ../fuzzy/fuzzy_matrix.cpp fuzzy_bench.cpp \
+ *          -lfuzzylite -o fuzzy_bench
+ */
+
+
+#include<chrono>
+#include<cmath>
+#include<cstddef>
+#include<iostream>
+#include<random>
+#include<vector>
+
+#include "fuzzy_controller.h"
+
+
+// Vehicles compared against the fuzzy engine, more than one block
+#define CHECK_VEHICLES 40
+// Random inputs applied to each compared vehicle
+#define CHECK_STEPS 500
+// Largest accepted difference of steer, accel and brake
+#define CHECK_TOLERANCE 1e-4
+
+// Vehicles in a timed batch
+#define BENCH_VEHICLES 10000
+// Timed batches of batched evaluation
+#define BENCH_REPEATS 200
+
+
+namespace
+{
+
+    /** random fuzzy inputs covering all terms and the ranges no rule applies to **/
+    class InputGenerator
+    {
+        public:
+
+            InputGenerator() : m_random(2018) {}
+
+            void generate(controller::fuzzy_inputs * t_fuzzy_inputs)
+            {
+                t_fuzzy_inputs->speed = uniform(-2, 110);
+                t_fuzzy_inputs->acceleration = uniform(-3, 35);
+                t_fuzzy_inputs->path = uniform(-0.7, 0.7);
+                t_fuzzy_inputs->next_path = uniform(-0.6, 0.6);
+                t_fuzzy_inputs->stability = uniform(-0.2, 1.2);
+            }
+
+        private:
+
+            std::mt19937 m_random;
+
+            float uniform(float t_minimum, float t_maximum)
+            {
+                return std::uniform_real_distribution<float>(t_minimum, t_maximum)(m_random);
+            }
+    };
+
+
+    bool differs(float t_expected, float t_actual)
+    {
+        if(std::isnan(t_expected) || std::isnan(t_actual))
+        {
+            return std::isnan(t_expected) != std::isnan(t_actual);
+        }
+        return std::fabs(t_expected - t_actual) > CHECK_TOLERANCE;
+    }
+
+
+    double seconds_since(const std::chrono::steady_clock::time_point & t_start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+    }
+
+}
+
+
+int main()
+{
+    InputGenerator generator;
+    controller::fuzzy_matrix_scratch scratch;
+
+    /**
+     * Check
+     * -----
+     * Every vehicle has its own controller evaluated with get_output(),
+     * all vehicles together are evaluated with get_outputs().
+     *
+     */
+    std::vector<controller::FuzzyController *> references;
+    for(std::size_t i = 0; i < CHECK_VEHICLES; ++i)
+    {
+        references.push_back(new controller::FuzzyController);
+    }
+
+    controller::FuzzyController batch_controller;
+    std::vector<controller::fuzzy_inputs> inputs(CHECK_VEHICLES);
+    std::vector<controller::fuzzy_state> states(CHECK_VEHICLES);
+    for(std::size_t i = 0; i < CHECK_VEHICLES; ++i)
+    {
+        controller::FuzzyController::init_state(&states[i]);
+    }
+
+    std::size_t mismatches = 0;
+    for(std::size_t step = 0; step < CHECK_STEPS; ++step)
+    {
+        for(std::size_t i = 0; i < CHECK_VEHICLES; ++i)
+        {
+            generator.generate(&inputs[i]);
+        }
+
+        if(!batch_controller.get_outputs(inputs.data(), states.data(), CHECK_VEHICLES, &scratch))
+        {
+            std::cout<<"Batched evaluation not available."<<std::endl;
+            return 1;
+        }
+
+        for(std::size_t i = 0; i < CHECK_VEHICLES; ++i)
+        {
+            const controller::fuzzy_outputs & expected = references[i]->get_output(&inputs[i]);
+            const controller::fuzzy_outputs & actual = states[i].outputs;
+
+            if(differs(expected.steer, actual.steer) || differs(expected.accel, actual.accel)
+                    || differs(expected.brake, actual.brake) || expected.gear != actual.gear)
+            {
+                if(++mismatches <= 10)
+                {
+                    std::cout<<"Mismatch at step "<<step<<", vehicle "<<i<<" : "
+                        <<"steer "<<expected.steer<<" / "<<actual.steer
+                        <<", accel "<<expected.accel<<" / "<<actual.accel
+                        <<", brake "<<expected.brake<<" / "<<actual.brake
+                        <<", gear "<<expected.gear<<" / "<<actual.gear<<std::endl;
+                }
+
+                // continue from the whole state of the engine
+                references[i]->get_state(&states[i]);
+            }
+        }
+    }
+
+    for(std::size_t i = 0; i < CHECK_VEHICLES; ++i)
+    {
+        delete references[i];
+    }
+
+    std::cout<<"Checked "<<CHECK_VEHICLES * CHECK_STEPS<<" outputs, "
+        <<mismatches<<" mismatches."<<std::endl;
+
+
+    /**
+     * Throughput
+     * ----------
+     * One thread, so vehicles per second are per core.
+     *
+     */
+    inputs.resize(BENCH_VEHICLES);
+    states.resize(BENCH_VEHICLES);
+    for(std::size_t i = 0; i < BENCH_VEHICLES; ++i)
+    {
+        generator.generate(&inputs[i]);
+        controller::FuzzyController::init_state(&states[i]);
+    }
+
+    // first call sizes the scratch space
+    batch_controller.get_outputs(inputs.data(), states.data(), BENCH_VEHICLES, &scratch);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(std::size_t repeat = 0; repeat < BENCH_REPEATS; ++repeat)
+    {
+        batch_controller.get_outputs(inputs.data(), states.data(), BENCH_VEHICLES, &scratch);
+    }
+    const double batch_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    float checksum = 0;
+    for(std::size_t i = 0; i < BENCH_VEHICLES; ++i)
+    {
+        checksum += batch_controller.get_output(&inputs[i]).steer;
+    }
+    const double engine_seconds = seconds_since(start);
+
+    std::cout<<"get_outputs() : "<<BENCH_VEHICLES<<" vehicles per batch, "
+        <<BENCH_VEHICLES * BENCH_REPEATS / batch_seconds<<" vehicles/s per core"<<std::endl;
+    std::cout<<"get_output()  : "<<BENCH_VEHICLES / engine_seconds
+        <<" vehicles/s per core (checksum "<<checksum<<")"<<std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
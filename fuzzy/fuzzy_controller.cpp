@@ -20,7 +20,7 @@
 /*
  * fuzzy_controller.cpp
  *
- *     version  : 1.0.0
+ *     version  : 1.1.0
  *  created on  : 18 Feb 2018
  *      author  : M.S.Khan
  */
@@ -33,6 +33,8 @@
 #include "fuzzy_values.h"
 
 #include <fl/Engine.h>
+#include <fl/Exception.h>
+#include <fl/Operation.h>
 #include <fl/norm/s/AlgebraicSum.h>
 #include <fl/norm/s/Maximum.h>
 #include <fl/term/Ramp.h>
@@ -48,6 +50,8 @@ controller::FuzzyController::FuzzyController()
     m_fuzzy_engine->setName("Fuzzy Controller Engine");
     m_fuzzy_engine->setDescription("fuzzy controller for deciding control values");
 
+    m_fuzzy_matrix = NULL;
+
     m_fuzzy_outputs = {0, 0, 0, 1};    // initialize steer, accel, gear and brake values
     m_speed_at_gear_change = 0;
 
@@ -73,6 +77,18 @@ controller::FuzzyController::FuzzyController()
     else
     {
         std::cout<<"Loaded successfully."<<std::endl;
+
+        // lower the rule base for batched evaluation, get_output()
+        // does not depend on it
+        try
+        {
+            m_fuzzy_matrix = new FuzzyMatrix(m_fuzzy_engine);
+        }
+        catch(const fl::Exception & exception)
+        {
+            std::cout<<"Batched evaluation not available : "
+                <<std::endl<<exception.what()<<std::endl;
+        }
     }
 }
 
@@ -230,6 +246,148 @@ const controller::fuzzy_outputs & controller::FuzzyController::get_output(
     m_fuzzy_outputs.accel = m_fuzzy_engine->getOutputVariable(OUTPUT_ACCEL)->getValue();
     m_fuzzy_outputs.brake = m_fuzzy_engine->getOutputVariable(OUTPUT_BRAKE)->getValue();
 
+    // modify gear value
+    update_gear(t_fuzzy_inputs->speed,
+            m_fuzzy_engine->getOutputVariable(OUTPUT_GEAR)->getValue(),
+            m_fuzzy_outputs, m_speed_at_gear_change);
+
+    return m_fuzzy_outputs;
+}
+
+
+bool controller::FuzzyController::get_outputs(const fuzzy_inputs * t_fuzzy_inputs,
+        fuzzy_state * t_fuzzy_states, std::size_t t_count,
+        fuzzy_matrix_scratch * t_scratch) const
+{
+    if(m_fuzzy_matrix == NULL)
+    {
+        return false;
+    }
+
+    const std::size_t speed = m_fuzzy_matrix->input_index(INPUT_SPEED);
+    const std::size_t acceleration = m_fuzzy_matrix->input_index(INPUT_ACCELERATION);
+    const std::size_t path = m_fuzzy_matrix->input_index(INPUT_PATH);
+    const std::size_t next_path = m_fuzzy_matrix->input_index(INPUT_NEXT_PATH);
+    const std::size_t stability = m_fuzzy_matrix->input_index(INPUT_STABILITY);
+
+    const std::size_t steer = m_fuzzy_matrix->output_index(OUTPUT_STEER);
+    const std::size_t accel = m_fuzzy_matrix->output_index(OUTPUT_ACCEL);
+    const std::size_t gear = m_fuzzy_matrix->output_index(OUTPUT_GEAR);
+    const std::size_t brake = m_fuzzy_matrix->output_index(OUTPUT_BRAKE);
+
+    // inputs and outputs of one block, sized once and reused between calls
+    t_scratch->inputs.resize(m_fuzzy_matrix->number_of_inputs() * FUZZY_MATRIX_BLOCK_SIZE);
+    t_scratch->outputs.resize(m_fuzzy_matrix->number_of_outputs() * FUZZY_MATRIX_BLOCK_SIZE);
+
+    for(std::size_t first = 0; first < t_count; first += FUZZY_MATRIX_BLOCK_SIZE)
+    {
+        std::size_t count = t_count - first;
+        if(count > FUZZY_MATRIX_BLOCK_SIZE)
+        {
+            count = FUZZY_MATRIX_BLOCK_SIZE;
+        }
+
+        const fuzzy_inputs * fuzzy_input = t_fuzzy_inputs + first;
+        fuzzy_state * state = t_fuzzy_states + first;
+        fl::scalar * inputs = t_scratch->inputs.data();
+        fl::scalar * outputs = t_scratch->outputs.data();
+
+        // apply fuzzy inputs, previous outputs are used by variables
+        // which lock their previous value
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            inputs[speed * count + i] = fuzzy_input[i].speed;
+            inputs[acceleration * count + i] = fuzzy_input[i].acceleration;
+            inputs[path * count + i] = fuzzy_input[i].path;
+            inputs[next_path * count + i] = fuzzy_input[i].next_path;
+            inputs[stability * count + i] = fuzzy_input[i].stability;
+
+            outputs[steer * count + i] = state[i].previous_steer;
+            outputs[accel * count + i] = state[i].previous_accel;
+            outputs[gear * count + i] = state[i].previous_gear;
+            outputs[brake * count + i] = state[i].previous_brake;
+        }
+
+        // process the inputs
+        m_fuzzy_matrix->evaluate(inputs, outputs, count, t_scratch);
+
+        // copy the calculated outputs
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            const float fuzzy_steer = outputs[steer * count + i];
+            const float fuzzy_accel = outputs[accel * count + i];
+            const float fuzzy_gear = outputs[gear * count + i];
+            const float fuzzy_brake = outputs[brake * count + i];
+
+            state[i].outputs.steer = fuzzy_steer;
+            state[i].outputs.accel = fuzzy_accel;
+            state[i].outputs.brake = fuzzy_brake;
+
+            // keep the last finite values, as fl::OutputVariable::defuzzify() does
+            if(fl::Op::isFinite(fuzzy_steer))
+            {
+                state[i].previous_steer = fuzzy_steer;
+            }
+            if(fl::Op::isFinite(fuzzy_accel))
+            {
+                state[i].previous_accel = fuzzy_accel;
+            }
+            if(fl::Op::isFinite(fuzzy_gear))
+            {
+                state[i].previous_gear = fuzzy_gear;
+            }
+            if(fl::Op::isFinite(fuzzy_brake))
+            {
+                state[i].previous_brake = fuzzy_brake;
+            }
+
+            // modify gear value
+            update_gear(fuzzy_input[i].speed, fuzzy_gear,
+                    state[i].outputs, state[i].speed_at_gear_change);
+        }
+    }
+
+    return true;
+}
+
+
+void controller::FuzzyController::init_state(fuzzy_state * t_fuzzy_state)
+{
+    t_fuzzy_state->outputs = {0, 0, 0, 1};    // same initial values as a controller
+    t_fuzzy_state->speed_at_gear_change = 0;
+
+    // nothing defuzzified yet
+    t_fuzzy_state->previous_steer = fl::nan;
+    t_fuzzy_state->previous_accel = fl::nan;
+    t_fuzzy_state->previous_gear = fl::nan;
+    t_fuzzy_state->previous_brake = fl::nan;
+}
+
+
+void controller::FuzzyController::get_state(fuzzy_state * t_fuzzy_state) const
+{
+    t_fuzzy_state->outputs = m_fuzzy_outputs;
+    t_fuzzy_state->speed_at_gear_change = m_speed_at_gear_change;
+
+    t_fuzzy_state->previous_steer = get_previous_value(OUTPUT_STEER);
+    t_fuzzy_state->previous_accel = get_previous_value(OUTPUT_ACCEL);
+    t_fuzzy_state->previous_gear = get_previous_value(OUTPUT_GEAR);
+    t_fuzzy_state->previous_brake = get_previous_value(OUTPUT_BRAKE);
+}
+
+
+float controller::FuzzyController::get_previous_value(const std::string & t_name) const
+{
+    // the value the next defuzzification falls back to
+    const fl::OutputVariable * output = m_fuzzy_engine->getOutputVariable(t_name);
+    return fl::Op::isFinite(output->getValue()) ?
+        output->getValue() : output->getPreviousValue();
+}
+
+
+void controller::FuzzyController::update_gear(float t_speed, float t_fuzzy_gear,
+        fuzzy_outputs & t_fuzzy_outputs, float & t_speed_at_gear_change)
+{
     /**
      * Modify gear value
      * -----------------
@@ -241,26 +399,28 @@ const controller::fuzzy_outputs & controller::FuzzyController::get_output(
      * 2. The suggested gear is a small value (defined by LOW_GEAR_FOR_FREE_GEAR_CHANGES).
      *
      */
-    if(std::fabs(t_fuzzy_inputs->speed - m_speed_at_gear_change)
+    if(std::fabs(t_speed - t_speed_at_gear_change)
             >= MIN_ABS_SPEED_DIFF_FOR_GEAR_CHANGE
-            || m_fuzzy_outputs.gear <= LOW_GEAR_FOR_FREE_GEAR_CHANGES)
+            || t_fuzzy_outputs.gear <= LOW_GEAR_FOR_FREE_GEAR_CHANGES)
     {
-        float fuzzy_gear = m_fuzzy_engine->getOutputVariable(OUTPUT_GEAR)->getValue();
-
         // use std::ceil for normal gears and std::floor for reverse gear
-        m_fuzzy_outputs.gear = fuzzy_gear > 0 ?
-            std::ceil(fuzzy_gear) : std::floor(fuzzy_gear);
+        t_fuzzy_outputs.gear = t_fuzzy_gear > 0 ?
+            std::ceil(t_fuzzy_gear) : std::floor(t_fuzzy_gear);
 
         // record this speed for later comparison
-        m_speed_at_gear_change = t_fuzzy_inputs->speed;
+        t_speed_at_gear_change = t_speed;
     }
-
-    return m_fuzzy_outputs;
 }
 
 
 controller::FuzzyController::~FuzzyController()
 {
+    if(m_fuzzy_matrix != NULL)
+    {
+        delete m_fuzzy_matrix;
+        m_fuzzy_matrix = NULL;
+    }
+
     if(m_fuzzy_engine != NULL)
     {
         delete m_fuzzy_engine;
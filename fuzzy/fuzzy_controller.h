@@ -20,7 +20,7 @@
 /*
  * fuzzy_controller.h
  *
- *     version  : 1.0.0
+ *     version  : 1.1.0
  *  created on  : 18 Feb 2018
  *      author  : M.S.Khan
  */
@@ -29,11 +29,16 @@
 #ifndef FUZZY_CONTROLLER_H_
 #define FUZZY_CONTROLLER_H_
 
+#include <cstddef>
+#include <string>
+
 #include <fl/Engine.h>
 
+#include "fuzzy_matrix.h"
+
 
-// Fuzzy controller version - 1.0.0
-#define FUZZY_CONTROLLER_VERSION "1.0.0"
+// Fuzzy controller version - 1.1.0
+#define FUZZY_CONTROLLER_VERSION "1.1.0"
 
 
 // Threshold for discouraging frequent gear changes
@@ -82,6 +87,22 @@ namespace controller
     } fuzzy_outputs;
 
 
+    /** per vehicle state for batched evaluation **/
+    typedef struct fuzzy_state_struct
+    {
+
+        fuzzy_outputs outputs;          // last outputs of the vehicle
+        float speed_at_gear_change;     // recorded speed at last gear change
+
+        // last finite defuzzified values, NaN if none
+        float previous_steer;
+        float previous_accel;
+        float previous_gear;
+        float previous_brake;
+
+    } fuzzy_state;
+
+
     /*
      * =====================================================================================
      *        Class:  FuzzyController
@@ -101,6 +122,22 @@ namespace controller
             // get fuzzy outputs for the given set of fuzzy inputs
             const fuzzy_outputs & get_output(const fuzzy_inputs * m_fuzzy_inputs);
 
+            // get fuzzy outputs for a batch of vehicles, the outputs are
+            // stored in the state of each vehicle. Does not modify the
+            // controller, so disjoint parts of a batch can run in parallel
+            // with one scratch space per thread. Returns false when the
+            // rule base could not be lowered for batched evaluation.
+            bool get_outputs(const fuzzy_inputs * t_fuzzy_inputs,
+                    fuzzy_state * t_fuzzy_states, std::size_t t_count,
+                    fuzzy_matrix_scratch * t_scratch) const;
+
+            // initialize state of a vehicle before its first batch
+            static void init_state(fuzzy_state * t_fuzzy_state);
+
+            // state of the vehicle driven through get_output(),
+            // to continue it in a batch
+            void get_state(fuzzy_state * t_fuzzy_state) const;
+
 
         private:
 
@@ -108,6 +145,9 @@ namespace controller
 
             // fuzzy engine
             fl::Engine * m_fuzzy_engine;
+            // rule base of the engine lowered for batched evaluation,
+            // NULL when it has no dense form
+            FuzzyMatrix * m_fuzzy_matrix;
             // fuzzy output values
             fuzzy_outputs m_fuzzy_outputs; 
 
@@ -130,6 +170,13 @@ namespace controller
             void add_accel_rules();
             void add_brake_rules();
 
+            // previous value of an output variable of the fuzzy engine
+            float get_previous_value(const std::string & t_name) const;
+
+            // apply suggested gear while discouraging frequent gear changes
+            static void update_gear(float t_speed, float t_fuzzy_gear,
+                    fuzzy_outputs & t_fuzzy_outputs, float & t_speed_at_gear_change);
+
             // copy constructor
             FuzzyController(const FuzzyController &other);
 
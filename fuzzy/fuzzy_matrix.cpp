@@ -0,0 +1,859 @@
+/*
+ * =====================================================================================
+ * Copyright (C) 2018 M.S.Khan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * =====================================================================================
+ */
+
+/*
+ * fuzzy_matrix.cpp
+ *
+ *     version  : 1.1.0
+ *  created on  : 18 Oct 2026
+ *      author  : agent
+ */
+
+
+#include<string>
+#include<vector>
+
+#include "fuzzy_matrix.h"
+
+#include <fl/Exception.h>
+#include <fl/Operation.h>
+#include <fl/activation/First.h>
+#include <fl/activation/General.h>
+#include <fl/activation/Proportional.h>
+#include <fl/defuzzifier/Centroid.h>
+#include <fl/norm/s/AlgebraicSum.h>
+#include <fl/norm/s/Maximum.h>
+#include <fl/norm/t/AlgebraicProduct.h>
+#include <fl/norm/t/Minimum.h>
+#include <fl/rule/Antecedent.h>
+#include <fl/rule/Consequent.h>
+#include <fl/rule/Rule.h>
+#include <fl/term/Aggregated.h>
+#include <fl/term/Ramp.h>
+#include <fl/term/Rectangle.h>
+#include <fl/term/Trapezoid.h>
+
+
+namespace
+{
+
+    /** implication of a rule degree on an output term membership **/
+    struct product_implication
+    {
+        static fl::scalar compute(fl::scalar t_degree, fl::scalar t_membership)
+        {
+            return t_degree * t_membership;
+        }
+    };
+
+    struct minimum_implication
+    {
+        static fl::scalar compute(fl::scalar t_degree, fl::scalar t_membership)
+        {
+            return t_degree < t_membership ? t_degree : t_membership;
+        }
+    };
+
+
+    /** aggregation of implied terms **/
+    struct sum_aggregation
+    {
+        static fl::scalar compute(fl::scalar t_aggregated, fl::scalar t_implied)
+        {
+            return t_aggregated + t_implied;
+        }
+    };
+
+    struct algebraic_sum_aggregation
+    {
+        static fl::scalar compute(fl::scalar t_aggregated, fl::scalar t_implied)
+        {
+            return t_aggregated + t_implied - t_aggregated * t_implied;
+        }
+    };
+
+    struct maximum_aggregation
+    {
+        static fl::scalar compute(fl::scalar t_aggregated, fl::scalar t_implied)
+        {
+            return t_implied > t_aggregated ? t_implied : t_aggregated;
+        }
+    };
+
+
+    // aggregate one consequent into [samples x vehicles], rules that were
+    // not triggered have degree 0 and leave the aggregated term unchanged
+    template<class implication, class aggregation>
+    void aggregate(const fl::scalar * t_degrees, const fl::scalar * t_samples,
+            std::size_t t_resolution, std::size_t t_count, fl::scalar * t_aggregated)
+    {
+        for(std::size_t s = 0; s < t_resolution; ++s)
+        {
+            const fl::scalar membership = t_samples[s];
+            fl::scalar * aggregated = t_aggregated + s * FUZZY_MATRIX_BLOCK_SIZE;
+            for(std::size_t v = 0; v < t_count; ++v)
+            {
+                aggregated[v] = aggregation::compute(aggregated[v],
+                        implication::compute(t_degrees[v], membership));
+            }
+        }
+    }
+
+}
+
+
+controller::FuzzyMatrix::FuzzyMatrix(const fl::Engine * t_fuzzy_engine)
+{
+    m_max_resolution = 0;
+    m_macheps = fl::fuzzylite::macheps();
+
+    // flatten the input terms, these are the columns of the incidence structure
+    for(std::size_t i = 0; i < t_fuzzy_engine->numberOfInputVariables(); ++i)
+    {
+        add_input(t_fuzzy_engine->getInputVariable(i));
+    }
+
+    // sample the output terms at the points used by the defuzzifiers
+    for(std::size_t i = 0; i < t_fuzzy_engine->numberOfOutputVariables(); ++i)
+    {
+        add_output(t_fuzzy_engine->getOutputVariable(i));
+    }
+
+    // lower the rules, rule blocks keep the order used by fl::Engine::process()
+    std::vector<std::vector<consequent_struct> > consequents(m_outputs.size());
+    m_clause_offsets.push_back(0);
+    m_rule_clause_offsets.push_back(0);
+    for(std::size_t i = 0; i < t_fuzzy_engine->numberOfRuleBlocks(); ++i)
+    {
+        const fl::RuleBlock * rule_block = t_fuzzy_engine->getRuleBlock(i);
+        if(rule_block->isEnabled())
+        {
+            add_rule_block(rule_block, consequents);
+        }
+    }
+
+    // group the consequents by output variable
+    for(std::size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        m_outputs[i].first_consequent = m_consequents.size();
+        m_consequents.insert(m_consequents.end(),
+                consequents[i].begin(), consequents[i].end());
+        m_outputs[i].last_consequent = m_consequents.size();
+    }
+}
+
+
+void controller::FuzzyMatrix::add_input(const fl::InputVariable * t_input)
+{
+    const std::size_t variable = m_input_names.size();
+    m_input_names.push_back(t_input->getName());
+
+    // same bounds as fl::Variable::setValue()
+    m_input_minimum.push_back(t_input->isLockValueInRange() ?
+            t_input->getMinimum() : -fl::inf);
+    m_input_maximum.push_back(t_input->isLockValueInRange() ?
+            t_input->getMaximum() : fl::inf);
+
+    for(std::size_t i = 0; i < t_input->numberOfTerms(); ++i)
+    {
+        const fl::Term * term = t_input->getTerm(i);
+        const std::size_t index = m_input_terms.size();
+        m_input_terms.push_back(term);
+
+        // propositions on disabled variables have degree 0
+        if(!t_input->isEnabled())
+        {
+            m_zero_terms.push_back(index);
+            continue;
+        }
+
+        const fl::Trapezoid * trapezoid = dynamic_cast<const fl::Trapezoid *>(term);
+        const fl::Ramp * ramp = dynamic_cast<const fl::Ramp *>(term);
+        const fl::Rectangle * rectangle = dynamic_cast<const fl::Rectangle *>(term);
+
+        if(trapezoid != NULL
+                && fl::Op::isFinite(trapezoid->getVertexA() + trapezoid->getVertexD())
+                && trapezoid->getVertexA() < trapezoid->getVertexB()
+                && trapezoid->getVertexB() <= trapezoid->getVertexC()
+                && trapezoid->getVertexC() < trapezoid->getVertexD())
+        {
+            linear_term_struct linear_term;
+            linear_term.term = index;
+            linear_term.variable = variable;
+            linear_term.rise_slope = 1.0 / (trapezoid->getVertexB() - trapezoid->getVertexA());
+            linear_term.rise_offset = -trapezoid->getVertexA() * linear_term.rise_slope;
+            linear_term.fall_slope = -1.0 / (trapezoid->getVertexD() - trapezoid->getVertexC());
+            linear_term.fall_offset = -trapezoid->getVertexD() * linear_term.fall_slope;
+            linear_term.height = trapezoid->getHeight();
+            m_linear_terms.push_back(linear_term);
+        }
+        else if(ramp != NULL
+                && fl::Op::isFinite(ramp->getStart() + ramp->getEnd())
+                && ramp->getStart() != ramp->getEnd())
+        {
+            // the fall line is 1 everywhere, a falling ramp has a negative rise slope
+            linear_term_struct linear_term;
+            linear_term.term = index;
+            linear_term.variable = variable;
+            linear_term.rise_slope = 1.0 / (ramp->getEnd() - ramp->getStart());
+            linear_term.rise_offset = -ramp->getStart() * linear_term.rise_slope;
+            linear_term.fall_slope = 0.0;
+            linear_term.fall_offset = 1.0;
+            linear_term.height = ramp->getHeight();
+            m_linear_terms.push_back(linear_term);
+        }
+        else if(rectangle != NULL)
+        {
+            rectangle_term_struct rectangle_term;
+            rectangle_term.term = index;
+            rectangle_term.variable = variable;
+            rectangle_term.start = rectangle->getStart();
+            rectangle_term.end = rectangle->getEnd();
+            rectangle_term.height = rectangle->getHeight();
+            m_rectangle_terms.push_back(rectangle_term);
+        }
+        else
+        {
+            virtual_term_struct virtual_term;
+            virtual_term.term = index;
+            virtual_term.variable = variable;
+            virtual_term.fuzzy_term = term;
+            m_virtual_terms.push_back(virtual_term);
+        }
+    }
+}
+
+
+void controller::FuzzyMatrix::add_output(const fl::OutputVariable * t_output)
+{
+    const fl::Centroid * centroid =
+        dynamic_cast<const fl::Centroid *>(t_output->getDefuzzifier());
+    if(!t_output->isEnabled() || centroid == NULL
+            || !fl::Op::isFinite(t_output->getMinimum() + t_output->getMaximum()))
+    {
+        throw fl::Exception("[fuzzy matrix] output variable <"
+                + t_output->getName() + "> needs a Centroid over a finite range", FL_AT);
+    }
+
+    output_struct output;
+    output.name = t_output->getName();
+    output.first_consequent = 0;
+    output.last_consequent = 0;
+    output.first_sample = m_output_x.size();
+    output.resolution = centroid->getResolution();
+    output.default_value = t_output->getDefaultValue();
+    output.minimum = t_output->getMinimum();
+    output.maximum = t_output->getMaximum();
+    output.lock_previous_value = t_output->isLockPreviousValue();
+    output.lock_value_in_range = t_output->isLockValueInRange();
+
+    // aggregation is stored in the fuzzy output, none means plain sum
+    const fl::SNorm * aggregation = t_output->fuzzyOutput()->getAggregation();
+    if(aggregation == NULL)
+    {
+        output.aggregation = SUM_AGGREGATION;
+    }
+    else if(dynamic_cast<const fl::AlgebraicSum *>(aggregation) != NULL)
+    {
+        output.aggregation = ALGEBRAIC_SUM_AGGREGATION;
+    }
+    else if(dynamic_cast<const fl::Maximum *>(aggregation) != NULL)
+    {
+        output.aggregation = MAXIMUM_AGGREGATION;
+    }
+    else
+    {
+        throw fl::Exception("[fuzzy matrix] aggregation <" + aggregation->className()
+                + "> of output variable <" + output.name + "> has no dense form", FL_AT);
+    }
+
+    // same sample points as fl::Centroid::defuzzify()
+    const fl::scalar dx = (output.maximum - output.minimum) / output.resolution;
+    for(std::size_t i = 0; i < output.resolution; ++i)
+    {
+        m_output_x.push_back(output.minimum + (i + 0.5) * dx);
+    }
+
+    for(std::size_t i = 0; i < t_output->numberOfTerms(); ++i)
+    {
+        const fl::Term * term = t_output->getTerm(i);
+        m_output_terms.push_back(term);
+        m_output_term_samples.push_back(m_output_samples.size());
+        for(std::size_t j = 0; j < output.resolution; ++j)
+        {
+            m_output_samples.push_back(term->membership(m_output_x[output.first_sample + j]));
+        }
+    }
+
+    if(output.resolution > m_max_resolution)
+    {
+        m_max_resolution = output.resolution;
+    }
+    m_outputs.push_back(output);
+}
+
+
+void controller::FuzzyMatrix::add_rule_block(const fl::RuleBlock * t_rule_block,
+        std::vector<std::vector<consequent_struct> > & t_consequents)
+{
+    rule_block_struct rule_block;
+    rule_block.first_rule = m_rule_weights.size();
+    rule_block.activation_rules = 0;
+    rule_block.activation_threshold = 0.0;
+
+    const fl::Activation * activation = t_rule_block->getActivation();
+    const fl::First * first = dynamic_cast<const fl::First *>(activation);
+    if(first != NULL)
+    {
+        rule_block.activation = FIRST_ACTIVATION;
+        rule_block.activation_rules = first->getNumberOfRules();
+        rule_block.activation_threshold = first->getThreshold();
+    }
+    else if(dynamic_cast<const fl::Proportional *>(activation) != NULL)
+    {
+        rule_block.activation = PROPORTIONAL_ACTIVATION;
+    }
+    else if(dynamic_cast<const fl::General *>(activation) != NULL)
+    {
+        rule_block.activation = GENERAL_ACTIVATION;
+    }
+    else
+    {
+        throw fl::Exception("[fuzzy matrix] activation of rule block <"
+                + t_rule_block->getName() + "> has no dense form", FL_AT);
+    }
+
+    implication_type implication = PRODUCT_IMPLICATION;
+    const fl::TNorm * implication_norm = t_rule_block->getImplication();
+    if(dynamic_cast<const fl::Minimum *>(implication_norm) != NULL)
+    {
+        implication = MINIMUM_IMPLICATION;
+    }
+    else if(dynamic_cast<const fl::AlgebraicProduct *>(implication_norm) == NULL
+            && t_rule_block->numberOfRules() > 0)
+    {
+        throw fl::Exception("[fuzzy matrix] implication of rule block <"
+                + t_rule_block->getName() + "> has no dense form", FL_AT);
+    }
+
+    for(std::size_t i = 0; i < t_rule_block->numberOfRules(); ++i)
+    {
+        // the activations skip rules that are not loaded, disabled rules
+        // are still activated but never triggered
+        const fl::Rule * rule = t_rule_block->getRule(i);
+        if(!rule->isLoaded())
+        {
+            continue;
+        }
+
+        // antecedent as a disjunction of conjunctive clauses
+        std::vector<std::vector<std::size_t> > clauses;
+        add_clauses(rule->getAntecedent()->getExpression(), t_rule_block, clauses);
+        for(std::size_t j = 0; j < clauses.size(); ++j)
+        {
+            m_clause_terms.insert(m_clause_terms.end(),
+                    clauses[j].begin(), clauses[j].end());
+            m_clause_offsets.push_back(m_clause_terms.size());
+        }
+        m_rule_clause_offsets.push_back(m_clause_offsets.size() - 1);
+
+        const std::vector<fl::Proposition *> & conclusions =
+            rule->getConsequent()->conclusions();
+        for(std::size_t j = 0; j < conclusions.size(); ++j)
+        {
+            if(!conclusions[j]->hedges.empty())
+            {
+                throw fl::Exception("[fuzzy matrix] hedges in rule <" + rule->getText()
+                        + "> have no dense form", FL_AT);
+            }
+
+            consequent_struct consequent;
+            consequent.rule = m_rule_weights.size();
+            consequent.term = output_term_index(conclusions[j]->term);
+            consequent.implication = implication;
+            t_consequents[output_index(conclusions[j]->variable->getName())]
+                .push_back(consequent);
+        }
+
+        m_rule_weights.push_back(rule->getWeight());
+        m_rule_enabled.push_back(rule->isEnabled());
+    }
+
+    rule_block.last_rule = m_rule_weights.size();
+    m_rule_blocks.push_back(rule_block);
+}
+
+
+void controller::FuzzyMatrix::add_clauses(const fl::Expression * t_expression,
+        const fl::RuleBlock * t_rule_block,
+        std::vector<std::vector<std::size_t> > & t_clauses) const
+{
+    if(t_expression->type() == fl::Expression::Proposition)
+    {
+        const fl::Proposition * proposition =
+            static_cast<const fl::Proposition *>(t_expression);
+        if(!proposition->hedges.empty())
+        {
+            throw fl::Exception("[fuzzy matrix] hedges in rule block <"
+                    + t_rule_block->getName() + "> have no dense form", FL_AT);
+        }
+
+        t_clauses.push_back(std::vector<std::size_t>(1,
+                    input_term_index(proposition->term)));
+        return;
+    }
+
+    const fl::Operator * fuzzy_operator = static_cast<const fl::Operator *>(t_expression);
+    std::vector<std::vector<std::size_t> > left_clauses;
+    std::vector<std::vector<std::size_t> > right_clauses;
+    add_clauses(fuzzy_operator->left, t_rule_block, left_clauses);
+    add_clauses(fuzzy_operator->right, t_rule_block, right_clauses);
+
+    /**
+     * Minimum and Maximum distribute over each other, so any and/or tree is
+     * equal to the maximum over clauses of the minimum over clause terms :
+     *
+     *     (a or b) and c  =  (a and c) or (b and c)
+     *
+     */
+    if(fuzzy_operator->name == fl::Rule::andKeyword()
+            && dynamic_cast<const fl::Minimum *>(t_rule_block->getConjunction()) != NULL)
+    {
+        for(std::size_t i = 0; i < left_clauses.size(); ++i)
+        {
+            for(std::size_t j = 0; j < right_clauses.size(); ++j)
+            {
+                std::vector<std::size_t> clause(left_clauses[i]);
+                clause.insert(clause.end(), right_clauses[j].begin(), right_clauses[j].end());
+                t_clauses.push_back(clause);
+            }
+        }
+    }
+    else if(fuzzy_operator->name == fl::Rule::orKeyword()
+            && dynamic_cast<const fl::Maximum *>(t_rule_block->getDisjunction()) != NULL)
+    {
+        t_clauses.insert(t_clauses.end(), left_clauses.begin(), left_clauses.end());
+        t_clauses.insert(t_clauses.end(), right_clauses.begin(), right_clauses.end());
+    }
+    else
+    {
+        throw fl::Exception("[fuzzy matrix] operator <" + fuzzy_operator->name
+                + "> in rule block <" + t_rule_block->getName()
+                + "> has no dense form", FL_AT);
+    }
+}
+
+
+std::size_t controller::FuzzyMatrix::input_term_index(const fl::Term * t_term) const
+{
+    for(std::size_t i = 0; i < m_input_terms.size(); ++i)
+    {
+        if(m_input_terms[i] == t_term)
+        {
+            return i;
+        }
+    }
+    throw fl::Exception("[fuzzy matrix] antecedent term <" + t_term->getName()
+            + "> is not an input term", FL_AT);
+}
+
+
+std::size_t controller::FuzzyMatrix::output_term_index(const fl::Term * t_term) const
+{
+    for(std::size_t i = 0; i < m_output_terms.size(); ++i)
+    {
+        if(m_output_terms[i] == t_term)
+        {
+            return i;
+        }
+    }
+    throw fl::Exception("[fuzzy matrix] consequent term <" + t_term->getName()
+            + "> is not an output term", FL_AT);
+}
+
+
+std::size_t controller::FuzzyMatrix::input_index(const std::string & t_name) const
+{
+    for(std::size_t i = 0; i < m_input_names.size(); ++i)
+    {
+        if(m_input_names[i] == t_name)
+        {
+            return i;
+        }
+    }
+    throw fl::Exception("[fuzzy matrix] input variable <" + t_name + "> not found", FL_AT);
+}
+
+
+std::size_t controller::FuzzyMatrix::output_index(const std::string & t_name) const
+{
+    for(std::size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        if(m_outputs[i].name == t_name)
+        {
+            return i;
+        }
+    }
+    throw fl::Exception("[fuzzy matrix] output variable <" + t_name + "> not found", FL_AT);
+}
+
+
+std::size_t controller::FuzzyMatrix::number_of_inputs() const
+{
+    return m_input_names.size();
+}
+
+
+std::size_t controller::FuzzyMatrix::number_of_outputs() const
+{
+    return m_outputs.size();
+}
+
+
+void controller::FuzzyMatrix::evaluate(const fl::scalar * t_inputs,
+        fl::scalar * t_outputs, std::size_t t_count, fuzzy_matrix_scratch * t_scratch) const
+{
+    if(t_count > FUZZY_MATRIX_BLOCK_SIZE)
+    {
+        throw fl::Exception("[fuzzy matrix] more vehicles than FUZZY_MATRIX_BLOCK_SIZE", FL_AT);
+    }
+
+    // sized once for a block, later calls do not allocate
+    t_scratch->memberships.resize(m_input_terms.size() * FUZZY_MATRIX_BLOCK_SIZE);
+    t_scratch->degrees.resize(m_rule_weights.size() * FUZZY_MATRIX_BLOCK_SIZE);
+    t_scratch->aggregated.resize(m_max_resolution * FUZZY_MATRIX_BLOCK_SIZE);
+
+    fl::scalar * memberships = t_scratch->memberships.data();
+    fl::scalar * degrees = t_scratch->degrees.data();
+    fl::scalar * aggregated = t_scratch->aggregated.data();
+
+    // fuzzify, [input terms x vehicles]
+    for(std::size_t t = 0; t < m_linear_terms.size(); ++t)
+    {
+        const linear_term_struct & term = m_linear_terms[t];
+        const fl::scalar * x = t_inputs + term.variable * t_count;
+        const fl::scalar minimum = m_input_minimum[term.variable];
+        const fl::scalar maximum = m_input_maximum[term.variable];
+        const fl::scalar rise_offset = term.rise_offset;
+        const fl::scalar rise_slope = term.rise_slope;
+        const fl::scalar fall_offset = term.fall_offset;
+        const fl::scalar fall_slope = term.fall_slope;
+        const fl::scalar height = term.height;
+        fl::scalar * membership = memberships + term.term * FUZZY_MATRIX_BLOCK_SIZE;
+
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            fl::scalar value = x[v] > maximum ? maximum : x[v];
+            value = value < minimum ? minimum : value;
+
+            const fl::scalar rise = rise_offset + rise_slope * value;
+            const fl::scalar fall = fall_offset + fall_slope * value;
+            fl::scalar degree = fall < rise ? fall : rise;
+            degree = degree < 0.0 ? 0.0 : degree;
+            degree = degree > 1.0 ? 1.0 : degree;
+            membership[v] = height * degree;
+        }
+    }
+
+    for(std::size_t t = 0; t < m_rectangle_terms.size(); ++t)
+    {
+        const rectangle_term_struct & term = m_rectangle_terms[t];
+        const fl::scalar * x = t_inputs + term.variable * t_count;
+        const fl::scalar minimum = m_input_minimum[term.variable];
+        const fl::scalar maximum = m_input_maximum[term.variable];
+        const fl::scalar start = term.start;
+        const fl::scalar end = term.end;
+        const fl::scalar height = term.height;
+        fl::scalar * membership = memberships + term.term * FUZZY_MATRIX_BLOCK_SIZE;
+
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            fl::scalar value = x[v] > maximum ? maximum : x[v];
+            value = value < minimum ? minimum : value;
+
+            // NaN stays NaN as in fl::Rectangle::membership()
+            const fl::scalar degree = value >= start && value <= end ? height : 0.0;
+            membership[v] = value != value ? value : degree;
+        }
+    }
+
+    for(std::size_t t = 0; t < m_virtual_terms.size(); ++t)
+    {
+        const virtual_term_struct & term = m_virtual_terms[t];
+        const fl::scalar * x = t_inputs + term.variable * t_count;
+        const fl::scalar minimum = m_input_minimum[term.variable];
+        const fl::scalar maximum = m_input_maximum[term.variable];
+        fl::scalar * membership = memberships + term.term * FUZZY_MATRIX_BLOCK_SIZE;
+
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            fl::scalar value = x[v] > maximum ? maximum : x[v];
+            value = value < minimum ? minimum : value;
+            membership[v] = term.fuzzy_term->membership(value);
+        }
+    }
+
+    for(std::size_t t = 0; t < m_zero_terms.size(); ++t)
+    {
+        fl::scalar * membership = memberships + m_zero_terms[t] * FUZZY_MATRIX_BLOCK_SIZE;
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            membership[v] = 0.0;
+        }
+    }
+
+    // fire rules, [rules x vehicles], NaN operands are ignored as in fl::Op::min()
+    fl::scalar clause[FUZZY_MATRIX_BLOCK_SIZE];
+    for(std::size_t r = 0; r < m_rule_weights.size(); ++r)
+    {
+        fl::scalar * degree = degrees + r * FUZZY_MATRIX_BLOCK_SIZE;
+
+        for(std::size_t c = m_rule_clause_offsets[r]; c < m_rule_clause_offsets[r + 1]; ++c)
+        {
+            // minimum over the clause terms
+            const fl::scalar * membership =
+                memberships + m_clause_terms[m_clause_offsets[c]] * FUZZY_MATRIX_BLOCK_SIZE;
+            for(std::size_t v = 0; v < t_count; ++v)
+            {
+                clause[v] = membership[v];
+            }
+            for(std::size_t i = m_clause_offsets[c] + 1; i < m_clause_offsets[c + 1]; ++i)
+            {
+                membership = memberships + m_clause_terms[i] * FUZZY_MATRIX_BLOCK_SIZE;
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    clause[v] = membership[v] < clause[v] || clause[v] != clause[v] ?
+                        membership[v] : clause[v];
+                }
+            }
+
+            // maximum over the clauses
+            if(c == m_rule_clause_offsets[r])
+            {
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    degree[v] = clause[v];
+                }
+            }
+            else
+            {
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    degree[v] = clause[v] > degree[v] || degree[v] != degree[v] ?
+                        clause[v] : degree[v];
+                }
+            }
+        }
+
+        const fl::scalar weight = m_rule_weights[r];
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            degree[v] *= weight;
+        }
+    }
+
+    /**
+     * Activate
+     * --------
+     * Degrees of rules that are not triggered are set to 0. A rule is triggered
+     * when its degree is greater than 0 within fl::fuzzylite::macheps(), as in
+     * fl::Op::isGt(). Disabled rules take part in the activation, they count
+     * to the sum of fl::Proportional and to the rules fired by fl::First,
+     * but are never triggered.
+     *
+     */
+    const fl::scalar macheps = m_macheps;
+    for(std::size_t b = 0; b < m_rule_blocks.size(); ++b)
+    {
+        const rule_block_struct & rule_block = m_rule_blocks[b];
+
+        fl::scalar sum[FUZZY_MATRIX_BLOCK_SIZE];
+        int activated[FUZZY_MATRIX_BLOCK_SIZE];
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            sum[v] = 0.0;
+            activated[v] = 0;
+        }
+
+        if(rule_block.activation == PROPORTIONAL_ACTIVATION)
+        {
+            for(std::size_t r = rule_block.first_rule; r < rule_block.last_rule; ++r)
+            {
+                const fl::scalar * degree = degrees + r * FUZZY_MATRIX_BLOCK_SIZE;
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    sum[v] += degree[v];
+                }
+            }
+        }
+
+        for(std::size_t r = rule_block.first_rule; r < rule_block.last_rule; ++r)
+        {
+            fl::scalar * degree = degrees + r * FUZZY_MATRIX_BLOCK_SIZE;
+            const fl::scalar enabled = m_rule_enabled[r] ? 1.0 : 0.0;
+
+            if(rule_block.activation == PROPORTIONAL_ACTIVATION)
+            {
+                // a zero sum gives NaN, which is not triggered
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    const fl::scalar normalized = degree[v] / sum[v];
+                    degree[v] = normalized >= macheps ? enabled * normalized : 0.0;
+                }
+            }
+            else if(rule_block.activation == FIRST_ACTIVATION)
+            {
+                const int activation_rules = rule_block.activation_rules;
+                const fl::scalar threshold = rule_block.activation_threshold - macheps;
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    const bool triggered = degree[v] >= macheps && degree[v] > threshold
+                        && activated[v] < activation_rules;
+                    activated[v] += triggered ? 1 : 0;
+                    degree[v] = triggered ? enabled * degree[v] : 0.0;
+                }
+            }
+            else
+            {
+                for(std::size_t v = 0; v < t_count; ++v)
+                {
+                    degree[v] = degree[v] >= macheps ? enabled * degree[v] : 0.0;
+                }
+            }
+        }
+    }
+
+    // aggregate, [vehicles x rules] by [rules x output samples], then defuzzify
+    for(std::size_t o = 0; o < m_outputs.size(); ++o)
+    {
+        const output_struct & output = m_outputs[o];
+        const std::size_t resolution = output.resolution;
+        const fl::scalar * x = &m_output_x[output.first_sample];
+
+        for(std::size_t s = 0; s < resolution; ++s)
+        {
+            fl::scalar * row = aggregated + s * FUZZY_MATRIX_BLOCK_SIZE;
+            for(std::size_t v = 0; v < t_count; ++v)
+            {
+                row[v] = 0.0;
+            }
+        }
+
+        // highest triggered degree, 0 means the fuzzy output is empty
+        fl::scalar fired[FUZZY_MATRIX_BLOCK_SIZE];
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            fired[v] = 0.0;
+        }
+
+        for(std::size_t c = output.first_consequent; c < output.last_consequent; ++c)
+        {
+            const consequent_struct & consequent = m_consequents[c];
+            const fl::scalar * degree = degrees + consequent.rule * FUZZY_MATRIX_BLOCK_SIZE;
+            const fl::scalar * samples =
+                &m_output_samples[m_output_term_samples[consequent.term]];
+
+            for(std::size_t v = 0; v < t_count; ++v)
+            {
+                fired[v] = degree[v] > fired[v] ? degree[v] : fired[v];
+            }
+
+            if(consequent.implication == PRODUCT_IMPLICATION)
+            {
+                if(output.aggregation == ALGEBRAIC_SUM_AGGREGATION)
+                {
+                    aggregate<product_implication, algebraic_sum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+                else if(output.aggregation == MAXIMUM_AGGREGATION)
+                {
+                    aggregate<product_implication, maximum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+                else
+                {
+                    aggregate<product_implication, sum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+            }
+            else
+            {
+                if(output.aggregation == ALGEBRAIC_SUM_AGGREGATION)
+                {
+                    aggregate<minimum_implication, algebraic_sum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+                else if(output.aggregation == MAXIMUM_AGGREGATION)
+                {
+                    aggregate<minimum_implication, maximum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+                else
+                {
+                    aggregate<minimum_implication, sum_aggregation>(
+                            degree, samples, resolution, t_count, aggregated);
+                }
+            }
+        }
+
+        // centroid of the aggregated terms
+        fl::scalar area[FUZZY_MATRIX_BLOCK_SIZE];
+        fl::scalar x_centroid[FUZZY_MATRIX_BLOCK_SIZE];
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            area[v] = 0.0;
+            x_centroid[v] = 0.0;
+        }
+        for(std::size_t s = 0; s < resolution; ++s)
+        {
+            const fl::scalar * row = aggregated + s * FUZZY_MATRIX_BLOCK_SIZE;
+            const fl::scalar x_sample = x[s];
+            for(std::size_t v = 0; v < t_count; ++v)
+            {
+                area[v] += row[v];
+                x_centroid[v] += row[v] * x_sample;
+            }
+        }
+
+        fl::scalar * value = t_outputs + o * t_count;
+        for(std::size_t v = 0; v < t_count; ++v)
+        {
+            if(fired[v] > 0.0)
+            {
+                value[v] = x_centroid[v] / area[v];
+            }
+            else
+            {
+                // no rule triggered, same fallback as fl::OutputVariable::defuzzify()
+                value[v] = output.lock_previous_value && fl::Op::isFinite(value[v]) ?
+                    value[v] : output.default_value;
+            }
+
+            if(output.lock_value_in_range)
+            {
+                value[v] = fl::Op::bound(value[v], output.minimum, output.maximum);
+            }
+        }
+    }
+}
+
+
+controller::FuzzyMatrix::~FuzzyMatrix()
+{
+}
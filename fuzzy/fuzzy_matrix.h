@@ -0,0 +1,259 @@
+/*
+ * =====================================================================================
+ * Copyright (C) 2018 M.S.Khan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * =====================================================================================
+ */
+
+/*
+ * fuzzy_matrix.h
+ *
+ *     version  : 1.1.0
+ *  created on  : 18 Oct 2026
+ *      author  : agent
+ */
+
+
+#ifndef FUZZY_MATRIX_H_
+#define FUZZY_MATRIX_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <fl/Engine.h>
+#include <fl/rule/Expression.h>
+#include <fl/rule/RuleBlock.h>
+#include <fl/term/Term.h>
+#include <fl/variable/InputVariable.h>
+#include <fl/variable/OutputVariable.h>
+
+
+// Number of vehicles evaluated together in one cache block
+#define FUZZY_MATRIX_BLOCK_SIZE 32
+
+
+namespace controller
+{
+
+    /** scratch space of batched evaluation, reused between calls **/
+    typedef struct fuzzy_matrix_scratch_struct
+    {
+
+        std::vector<fl::scalar> inputs;         // [inputs x vehicles] of one block
+        std::vector<fl::scalar> outputs;        // [outputs x vehicles] of one block
+        std::vector<fl::scalar> memberships;    // [input terms x vehicles]
+        std::vector<fl::scalar> degrees;        // [rules x vehicles]
+        std::vector<fl::scalar> aggregated;     // [output samples x vehicles]
+
+    } fuzzy_matrix_scratch;
+
+
+    /*
+     * =====================================================================================
+     *        Class:  FuzzyMatrix
+     *  Description:  Dense form of the rule base of a loaded fl::Engine.
+     *                Membership degrees of a batch form a [input terms x vehicles]
+     *                matrix, rules fire through min/max reductions over a
+     *                rule x term incidence structure and the consequents are
+     *                aggregated and defuzzified against [output terms x samples]
+     *                tables precomputed for the Centroid defuzzifiers.
+     *
+     *                Trapezoid, Ramp and Rectangle input terms and all output
+     *                terms are copied while lowering. Other input terms are
+     *                evaluated through their fl::Term, so the matrix must not
+     *                outlive the engine and has to be rebuilt when the engine
+     *                changes. Evaluation does not modify the matrix and is safe
+     *                to call from several threads with separate scratch space.
+     *
+     *                Known differences to fl::Engine::process() :
+     *
+     *                1. Lowered terms compare exactly, fuzzylite compares within
+     *                   fl::fuzzylite::macheps() at the vertices.
+     *
+     *                2. "or" is distributed over "and", which is exact for
+     *                   Minimum and Maximum unless a membership is NaN.
+     *
+     * =====================================================================================
+     */
+    class FuzzyMatrix
+    {
+        public:
+
+            // lower the rule base of the engine, throws fl::Exception
+            // when the engine uses operators that have no dense form
+            explicit FuzzyMatrix(const fl::Engine * t_fuzzy_engine);
+            ~FuzzyMatrix();
+
+            // row of an input or output variable in evaluate() buffers
+            std::size_t input_index(const std::string & t_name) const;
+            std::size_t output_index(const std::string & t_name) const;
+
+            std::size_t number_of_inputs() const;
+            std::size_t number_of_outputs() const;
+
+            // evaluate one block of t_count vehicles, at most
+            // FUZZY_MATRIX_BLOCK_SIZE. t_inputs is [inputs x t_count] and
+            // t_outputs is [outputs x t_count], both row-major. On entry
+            // t_outputs holds the last finite output values (NaN if none).
+            void evaluate(const fl::scalar * t_inputs, fl::scalar * t_outputs,
+                    std::size_t t_count, fuzzy_matrix_scratch * t_scratch) const;
+
+
+        private:
+
+            /** TYPES **/
+
+            enum activation_type { GENERAL_ACTIVATION, FIRST_ACTIVATION,
+                PROPORTIONAL_ACTIVATION };
+            enum implication_type { PRODUCT_IMPLICATION, MINIMUM_IMPLICATION };
+            enum aggregation_type { SUM_AGGREGATION, ALGEBRAIC_SUM_AGGREGATION,
+                MAXIMUM_AGGREGATION };
+
+            // Trapezoid or Ramp as height * min(rise, fall) bounded to [0, 1],
+            // where rise and fall are lines of the input value
+            struct linear_term_struct
+            {
+                std::size_t term;
+                std::size_t variable;
+                fl::scalar rise_offset;
+                fl::scalar rise_slope;
+                fl::scalar fall_offset;
+                fl::scalar fall_slope;
+                fl::scalar height;
+            };
+
+            // Rectangle as height inside [start, end]
+            struct rectangle_term_struct
+            {
+                std::size_t term;
+                std::size_t variable;
+                fl::scalar start;
+                fl::scalar end;
+                fl::scalar height;
+            };
+
+            // any other term, evaluated through the engine
+            struct virtual_term_struct
+            {
+                std::size_t term;
+                std::size_t variable;
+                const fl::Term * fuzzy_term;
+            };
+
+            // rules [first_rule, last_rule) of one rule block
+            struct rule_block_struct
+            {
+                std::size_t first_rule;
+                std::size_t last_rule;
+                activation_type activation;
+                int activation_rules;       // number of rules fired by fl::First
+                fl::scalar activation_threshold;
+            };
+
+            // rule sets output term (index in m_output_terms)
+            struct consequent_struct
+            {
+                std::size_t rule;
+                std::size_t term;
+                implication_type implication;
+            };
+
+            // consequents [first_consequent, last_consequent) of one output
+            struct output_struct
+            {
+                std::string name;
+                std::size_t first_consequent;
+                std::size_t last_consequent;
+                std::size_t first_sample;   // offset in m_output_x
+                std::size_t resolution;
+                aggregation_type aggregation;
+                fl::scalar default_value;
+                fl::scalar minimum;
+                fl::scalar maximum;
+                bool lock_previous_value;
+                bool lock_value_in_range;
+            };
+
+
+            /** MEMBER VARIABLES **/
+
+            // input variables, values outside [minimum, maximum] are bounded
+            std::vector<std::string> m_input_names;
+            std::vector<fl::scalar> m_input_minimum;
+            std::vector<fl::scalar> m_input_maximum;
+
+            // flattened input terms, grouped by how they are evaluated
+            std::vector<const fl::Term *> m_input_terms;
+            std::vector<linear_term_struct> m_linear_terms;
+            std::vector<rectangle_term_struct> m_rectangle_terms;
+            std::vector<virtual_term_struct> m_virtual_terms;
+            std::vector<std::size_t> m_zero_terms;      // terms of disabled inputs
+
+            // rule x term incidence, rule r fires with
+            // weight * max over its clauses of min over the clause terms
+            std::vector<std::size_t> m_clause_terms;
+            std::vector<std::size_t> m_clause_offsets;
+            std::vector<std::size_t> m_rule_clause_offsets;
+            std::vector<fl::scalar> m_rule_weights;
+            std::vector<bool> m_rule_enabled;
+            std::vector<rule_block_struct> m_rule_blocks;
+
+            // consequents grouped by output variable
+            std::vector<consequent_struct> m_consequents;
+            std::vector<output_struct> m_outputs;
+
+            // sample points of each output and output term
+            // memberships at those points, [output terms x samples]
+            std::vector<fl::scalar> m_output_x;
+            std::vector<fl::scalar> m_output_samples;
+            std::vector<const fl::Term *> m_output_terms;
+            std::vector<std::size_t> m_output_term_samples;
+            std::size_t m_max_resolution;
+
+            // tolerance of fl::Op comparisons
+            fl::scalar m_macheps;
+
+
+            /** MEMBER FUNCTIONS **/
+
+            // add the terms of an input variable
+            void add_input(const fl::InputVariable * t_input);
+            // add the term memberships of an output at its sample points
+            void add_output(const fl::OutputVariable * t_output);
+            // lower the rules of a rule block, consequents are collected per output
+            void add_rule_block(const fl::RuleBlock * t_rule_block,
+                    std::vector<std::vector<consequent_struct> > & t_consequents);
+
+            // lower an antecedent expression to clauses of input terms
+            void add_clauses(const fl::Expression * t_expression,
+                    const fl::RuleBlock * t_rule_block,
+                    std::vector<std::vector<std::size_t> > & t_clauses) const;
+
+            // index of a term in m_input_terms or m_output_terms
+            std::size_t input_term_index(const fl::Term * t_term) const;
+            std::size_t output_term_index(const fl::Term * t_term) const;
+
+            // copy constructor
+            FuzzyMatrix(const FuzzyMatrix &other);
+
+            // assignment operator
+            FuzzyMatrix& operator=(const FuzzyMatrix &other);
+
+    };       /** class FuzzyMatrix **/
+
+}
+
+#endif      /** ifndef FUZZY_MATRIX_H_ **/